@@ -9,6 +9,17 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <array>
+#include <cstring>
+#include <unordered_set>
+#include <future>
+#include <mutex>
+#include <chrono>
+#include <sstream>
 
 constexpr uint32_t WIDTH = 800;
 constexpr uint32_t HEIGHT = 600;
@@ -25,21 +36,151 @@ const std::vector<const char*> requiredPhyDeviceExtensions = {
     vk::KHRCreateRenderpass2ExtensionName
 };
 
+// enabled when present, without VK_EXT_memory_budget heap budgets are estimated from heap sizes and our own allocations
+const std::vector<const char*> optionalPhyDeviceExtensions = {
+    vk::EXTMemoryBudgetExtensionName
+};
+
+const std::string SHADER_PATH = R"(shaders\slang.spv)";
+const std::string TEXTURE_PATH = R"(textures\mipdebug.ktx2)";
+constexpr uint32_t MAX_STREAMED_TEXTURES = 64;
+constexpr uint32_t TEXTURE_FEEDBACK_NONE = ~0u;
+constexpr vk::DeviceSize MAX_TEXTURE_UPLOAD_BYTES_PER_FRAME = 16ull * 1024 * 1024;
+constexpr vk::DeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+constexpr vk::DeviceSize STAGING_ALIGNMENT = 16; // covers the texel block size of every supported format
+
+constexpr uint32_t MEMORY_METRICS_LOG_INTERVAL = 600;
+constexpr double MEMORY_BUDGET_HIGH_WATERMARK = 0.90;
+constexpr double MEMORY_BUDGET_LOW_WATERMARK = 0.80;
+constexpr double MEMORY_BUDGET_FALLBACK_FRACTION = 0.80;
+constexpr vk::DeviceSize MAX_EVICTION_BYTES_PER_FRAME = 32ull * 1024 * 1024;
+
+// everything device selection and creation needs, queried once per physical device
+struct DeviceCapabilities {
+    vk::PhysicalDeviceProperties properties{};
+    vk::PhysicalDeviceFeatures features{};
+    bool shaderDrawParameters = false;
+    bool dynamicRendering = false;
+    bool synchronization2 = false;
+    bool shaderDemoteToHelperInvocation = false; // IsHelperLane in the texture feedback
+    bool extendedDynamicState = false;
+    bool fragmentSubgroupArithmetic = false; // texture feedback reduces its atomics with WaveActiveMin
+    vk::PhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<vk::QueueFamilyProperties> queueFamilies{};
+    bool hasPresentQueueFamily = false;
+    uint32_t presentQueueFamily = 0; // first graphics queue family that can present to the surface
+    std::unordered_set<std::string> extensions{};
+    std::vector<vk::SurfaceFormatKHR> surfaceFormats{}; // only queried when the device can present
+    std::vector<vk::PresentModeKHR> presentModes{};
+};
+
+// --serial-startup runs every startup phase on the main thread, --startup-benchmark exits after the first frame,
+// together they give a before and after time to first frame for the parallel startup
+struct StartupOptions {
+    bool serial = false;
+    bool benchmark = false;
+};
+
+struct HeapBudget {
+    vk::DeviceSize size = 0;
+    vk::DeviceSize budget = 0;
+    vk::DeviceSize usage = 0;
+    vk::DeviceSize trackedUsage = 0; // bytes we allocated ourselves, stands in for usage when the driver can't report it
+    bool deviceLocal = false;
+    bool overBudget = false; // still above the low watermark after eviction, e.g. from memory other processes hold
+};
+
+// snapshot of the memory state as of the latest frame, what getMemoryMetrics hands out
+struct MemoryMetrics {
+    uint64_t frameIndex = 0;
+    bool driverReported = false; // false when budgets are estimated because VK_EXT_memory_budget is missing
+    std::vector<HeapBudget> heaps{};
+    vk::DeviceSize evictedBytesLastFrame = 0;
+    vk::DeviceSize evictedBytesTotal = 0;
+};
+
+struct StreamableResource {
+    uint32_t heapIndex = 0;
+    vk::DeviceSize residentBytes = 0;
+    uint64_t lastUsedFrame = 0;
+    // frees some or all of the resource's memory and returns the bytes released, 0 once there is nothing left to drop
+    std::function<vk::DeviceSize()> evictStep;
+    std::list<uint32_t>::iterator lruPosition;
+};
+
+struct Ktx2Level {
+    uint64_t byteOffset = 0;
+    uint64_t byteLength = 0;
+};
+
+struct Ktx2File {
+    std::string path;
+    vk::Format format = vk::Format::eUndefined;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t supercompressionScheme = 0;
+    bool builtinWhite = false; // stand in for a texture that can't be used, its one white texel is generated instead of read from path
+    std::vector<Ktx2Level> levels{}; // levels[0] is full resolution, left empty when the data can't be uploaded as is
+};
+
+struct StreamedTexture {
+    Ktx2File source;
+    vk::raii::Image image = nullptr;
+    vk::raii::ImageView view = nullptr;
+    vk::raii::Sampler sampler = nullptr;
+    vk::raii::DescriptorSet descriptorSet = nullptr;
+    vk::raii::DeviceMemory tailMemory = nullptr; // the sparse mip tail, or the whole chain when not sparse
+    std::vector<vk::raii::DeviceMemory> levelMemory{}; // per level sparse allocations, null while not resident
+    bool sparse = false;
+    uint32_t memoryTypeIndex = 0;
+    vk::DeviceSize sparseBlockSize = 0;
+    vk::Extent3D sparseGranularity{};
+    uint32_t mipTailFirstLevel = 0;
+    uint32_t minResidentLevel = 0; // this level and everything coarser stays resident
+    uint32_t residentLevel = 0; // finest resident level, also the sampler's minLod
+    uint32_t feedbackSlot = 0;
+    uint32_t residencyId = 0;
+    bool uploadPending = false; // a band of a finer level is being read or copied
+    uint32_t streamedBlockRows = 0; // block rows of level residentLevel - 1 uploaded so far, residentLevel changes once all have landed
+};
+
+struct StagingAllocation {
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize end = 0;
+};
+
+// a band of whole texel block rows of one level, levels larger than what the staging ring can take are uploaded in several
+struct TextureUpload {
+    uint32_t textureIndex = 0;
+    uint32_t level = 0;
+    uint32_t firstBlockRow = 0;
+    uint32_t blockRows = 0;
+    StagingAllocation staging{};
+    std::future<void> read{}; // file read straight into the staging ring on a worker
+};
+
 class HelloTriangleApplication {
 public:
-    void run() {
+    void run(StartupOptions const& options = {}) {
+        startupOptions = options;
+        startupBegin = std::chrono::steady_clock::now();
         initWindow();
         initVulkan();
         mainLoop();
         cleanup();
     }
 
+    MemoryMetrics const& getMemoryMetrics() const {
+        return memoryMetrics;
+    }
+
 private:
     GLFWwindow* window = nullptr;
     vk::raii::Context context{};
     vk::raii::Instance instance = nullptr;
     vk::raii::SurfaceKHR surface = nullptr;
     vk::raii::PhysicalDevice physicalDevice = nullptr;
+    DeviceCapabilities deviceCapabilities{};
     vk::raii::Device device = nullptr;
     vk::raii::Queue graphicsQueue = nullptr;
     uint32_t graphicsQfIndex = ~0;
@@ -49,12 +190,49 @@ private:
     vk::Extent2D swapchainExtent{};
     std::vector<vk::Image> swapchainImages{};
     std::vector<vk::raii::ImageView> swapchainImageViews{};
+    vk::raii::DescriptorSetLayout textureSetLayout = nullptr;
+    vk::raii::PipelineLayout pipelineLayout = nullptr;
     vk::raii::Pipeline graphicsPipeline = nullptr;
     vk::raii::CommandPool commandPool = nullptr;
     vk::raii::CommandBuffer commandBuffer = nullptr;
     vk::raii::Semaphore renderComplete = nullptr;
     vk::raii::Semaphore renderReady = nullptr;
     vk::raii::Fence commandBufferDone = nullptr;
+    bool memoryBudgetSupported = false;
+    bool bcTexturesSupported = false;
+    bool astcTexturesSupported = false;
+    bool sparseTexturesSupported = false;
+    vk::PhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<HeapBudget> heapBudgets{};
+    uint64_t frameIndex = 0;
+    uint64_t completedFrameIndex = 0;
+    uint32_t nextResidencyId = 0;
+    std::unordered_map<uint32_t, StreamableResource> streamableResources{};
+    std::list<uint32_t> residencyLru{}; // front is most recently used by the gpu
+    vk::DeviceSize evictedBytesLastFrame = 0;
+    vk::DeviceSize evictedBytesTotal = 0;
+    MemoryMetrics memoryMetrics{};
+    vk::raii::Buffer textureFeedbackBuffer = nullptr;
+    vk::raii::DeviceMemory textureFeedbackMemory = nullptr;
+    uint32_t* textureFeedback = nullptr; // persistently mapped, one wanted mip level per feedback slot
+    vk::raii::DescriptorPool descriptorPool = nullptr;
+    std::vector<StreamedTexture> textures{};
+    vk::raii::Buffer stagingRingBuffer = nullptr;
+    vk::raii::DeviceMemory stagingRingMemory = nullptr;
+    char* stagingRing = nullptr; // persistently mapped
+    vk::DeviceSize stagingHead = 0;
+    vk::DeviceSize stagingTail = 0;
+    uint32_t stagingAllocations = 0;
+    vk::raii::CommandBuffer textureUploadCommands = nullptr;
+    vk::raii::Semaphore textureBindDone = nullptr;
+    vk::raii::Fence textureUploadDone = nullptr;
+    std::vector<vk::raii::DeviceMemory> retiredTextureMemory{}; // unbound last frame, freed once the queue has gone idle
+    std::deque<TextureUpload> pendingTextureUploads{}; // declared after the ring so their reads finish before it is unmapped
+    std::vector<TextureUpload> submittedTextureUploads{};
+    StartupOptions startupOptions{};
+    std::chrono::steady_clock::time_point startupBegin{};
+    std::vector<std::pair<std::string, double>> startupTimings{};
+    std::mutex startupTimingsMutex{};
 
     void initWindow() {
         glfwInit();
@@ -65,17 +243,720 @@ private:
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan tutorial", nullptr, nullptr);
     }
 
+    // shader i/o depends on nothing and pipeline compilation only on the device, set layout and swapchain format,
+    // so both run on workers while the swapchain and everything after it is created here
     void initVulkan() {
-        createInstance();
-        createSurface();
-        pickPhysicalDevice();
-        createDevice();
-        createSwapchain();
-        createSwapchainImageViews();
-        createGraphicsPipeline();
-        createCommandPool();
-        createCommandBuffer();
-        createSyncObjects();
+        std::launch workerPolicy = startupOptions.serial ? std::launch::deferred : std::launch::async;
+
+        std::future<std::vector<char>> shaderBytecode = std::async(workerPolicy, [this]() {
+            std::vector<char> bytecode;
+            timePhase("Shader file read (worker)", [&]() { bytecode = readBinaryFile(SHADER_PATH); });
+            return bytecode;
+        });
+
+        timePhase("Instance", [this]() { createInstance(); });
+        timePhase("Surface", [this]() { createSurface(); });
+        timePhase("Physical device", [this]() { pickPhysicalDevice(); });
+        timePhase("Logical device", [this]() { createDevice(); });
+        timePhase("Memory budget tracking", [this]() { createMemoryBudgetTracking(); });
+        timePhase("Swapchain format", [this]() { chooseSwapchainFormat(); });
+        timePhase("Descriptor set layout", [this]() { createDescriptorSetLayout(); });
+
+        // the worker logs into its own stream, printed once it has joined so its lines don't interleave with the main thread's
+        std::ostringstream pipelineLog;
+        std::future<void> pipeline = std::async(workerPolicy, [this, &shaderBytecode, &pipelineLog]() {
+            std::vector<char> bytecode = shaderBytecode.get();
+            timePhase("Graphics pipeline (worker)", [&]() { createGraphicsPipeline(bytecode, pipelineLog); });
+        });
+
+        timePhase("Swapchain", [this]() { createSwapchain(); });
+        timePhase("Swapchain image views", [this]() { createSwapchainImageViews(); });
+        timePhase("Command pool and buffer", [this]() { createCommandPool(); createCommandBuffer(); });
+        timePhase("Sync objects", [this]() { createSyncObjects(); });
+        timePhase("Texture feedback and descriptor pool", [this]() { createTextureFeedbackBuffer(); createDescriptorPool(); });
+        timePhase("Texture upload resources", [this]() { createTextureUploadResources(); });
+        timePhase("Textures", [this]() { createTextures(); });
+        timePhase("Waiting on graphics pipeline", [&]() { pipeline.get(); });
+        std::cout << pipelineLog.str();
+
+        printStartupTimings();
+    }
+
+    template <typename Phase>
+    void timePhase(std::string const& name, Phase&& phase) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        phase();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(startupTimingsMutex);
+        startupTimings.emplace_back(name, milliseconds);
+    }
+
+    void printStartupTimings() {
+        std::cout << "STARTUP PHASE TIMINGS:\n";
+        for (std::pair<std::string, double> const& timing : startupTimings) {
+            std::cout << timing.first << ": " << timing.second << " ms\n";
+        }
+        std::cout << "Vulkan initialization done " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count() << " ms after startup\n\n";
+    }
+
+    void createTextures() {
+        std::cout << "CREATING TEXTURES:\n";
+
+        loadTexture(TEXTURE_PATH);
+
+        std::cout << "TEXTURE CREATION FINISHED\n\n";
+    }
+
+    // reads only the header and level index, level data is read from the file as each level is streamed in
+    Ktx2File readKtx2Header(std::string const& path) {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open KTX2 file:" + path);
+        }
+
+        static constexpr uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        uint8_t header[80]{};
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!file || memcmp(header, identifier, sizeof(identifier)) != 0) {
+            throw std::runtime_error("Not a KTX2 file:" + path);
+        }
+
+        // vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth, layerCount, faceCount, levelCount, supercompressionScheme
+        uint32_t fields[9]{};
+        memcpy(fields, header + sizeof(identifier), sizeof(fields));
+
+        if (fields[2] == 0 || fields[3] == 0 || fields[4] != 0 || fields[5] > 1 || fields[6] != 1) {
+            throw std::runtime_error("Only single 2D KTX2 textures are supported:" + path);
+        }
+
+        Ktx2File ktx = {
+            .path = path,
+            .format = static_cast<vk::Format>(fields[0]),
+            .width = fields[2],
+            .height = fields[3],
+            .supercompressionScheme = fields[8]
+        };
+
+        // supercompressed data and formats without a block size (VK_FORMAT_UNDEFINED in Basis/UASTC files) would need
+        // transcoding, the caller sees no levels and falls back to its default texture
+        if (ktx.supercompressionScheme != 0 || vk::blockSize(ktx.format) == 0) {
+            return ktx;
+        }
+
+        uint32_t levelCount = std::max(fields[7], 1u);
+        uint32_t fullChainLevels = 1;
+        for (uint32_t extent = std::max(ktx.width, ktx.height); extent > 1; extent >>= 1) {
+            fullChainLevels++;
+        }
+        if (levelCount > fullChainLevels) {
+            throw std::runtime_error("KTX2 texture has more levels than its size allows:" + path);
+        }
+
+        std::array<uint8_t, 3> blockExtent = vk::blockExtent(ktx.format);
+        uint8_t blockSize = vk::blockSize(ktx.format);
+
+        std::vector<uint64_t> levelIndex(levelCount * 3);
+        file.read(reinterpret_cast<char*>(levelIndex.data()), static_cast<std::streamsize>(levelIndex.size() * sizeof(uint64_t)));
+        if (!file) {
+            throw std::runtime_error("Truncated KTX2 level index:" + path);
+        }
+
+        file.seekg(0, std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+        for (uint32_t i = 0; i < levelCount; ++i) {
+            Ktx2Level level = { .byteOffset = levelIndex[i * 3], .byteLength = levelIndex[i * 3 + 1] };
+
+            uint64_t blocksWide = (std::max(1u, ktx.width >> i) + blockExtent[0] - 1) / blockExtent[0];
+            uint64_t blocksHigh = (std::max(1u, ktx.height >> i) + blockExtent[1] - 1) / blockExtent[1];
+            if (level.byteLength != blocksWide * blocksHigh * blockSize) {
+                throw std::runtime_error("KTX2 level " + std::to_string(i) + " has the wrong size for its format and extent:" + path);
+            }
+            if (level.byteOffset > fileSize || level.byteLength > fileSize - level.byteOffset) {
+                throw std::runtime_error("KTX2 level " + std::to_string(i) + " lies past the end of the file:" + path);
+            }
+
+            ktx.levels.push_back(level);
+        }
+
+        return ktx;
+    }
+
+    static void readKtx2RangeInto(std::string const& path, uint64_t byteOffset, uint64_t byteLength, char* destination) {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open KTX2 file:" + path);
+        }
+
+        file.seekg(static_cast<std::streamoff>(byteOffset), std::ios::beg);
+        file.read(destination, static_cast<std::streamsize>(byteLength));
+
+        if (!file) {
+            throw std::runtime_error("Truncated KTX2 level data:" + path);
+        }
+    }
+
+    std::future<void> readTextureBandAsync(StreamedTexture const& texture, TextureUpload const& upload) {
+        vk::DeviceSize rowBytes = textureBlockRowBytes(texture, upload.level);
+        uint64_t byteOffset = texture.source.levels[upload.level].byteOffset + upload.firstBlockRow * rowBytes;
+        uint64_t byteLength = upload.blockRows * rowBytes;
+        char* destination = stagingRing + upload.staging.offset;
+
+        if (texture.source.builtinWhite) {
+            std::fill_n(destination, byteLength, static_cast<char>(0xFF));
+            std::promise<void> filled;
+            filled.set_value();
+            return filled.get_future();
+        }
+
+        return std::async(std::launch::async, [path = texture.source.path, byteOffset, byteLength, destination]() {
+            readKtx2RangeInto(path, byteOffset, byteLength, destination);
+        });
+    }
+
+    // reserves staging for as many block rows as fit in maxBytes, at least one, and starts reading them
+    bool reserveTextureBand(uint32_t textureIndex, uint32_t level, uint32_t firstBlockRow, vk::DeviceSize maxBytes, TextureUpload& upload) {
+        StreamedTexture const& texture = textures[textureIndex];
+        vk::DeviceSize rowBytes = textureBlockRowBytes(texture, level);
+        vk::DeviceSize maxRows = std::max<vk::DeviceSize>(1, maxBytes / rowBytes);
+        uint32_t blockRows = static_cast<uint32_t>(std::min<vk::DeviceSize>(textureLevelBlockRows(texture, level) - firstBlockRow, maxRows));
+
+        upload = { .textureIndex = textureIndex, .level = level, .firstBlockRow = firstBlockRow, .blockRows = blockRows };
+        if (!reserveStaging(blockRows * rowBytes, upload.staging)) return false;
+
+        upload.read = readTextureBandAsync(texture, upload);
+        return true;
+    }
+
+    bool isTextureFormatSupported(vk::Format format) {
+        bool isBc = format == vk::Format::eBc7UnormBlock || format == vk::Format::eBc7SrgbBlock ||
+            format == vk::Format::eBc5UnormBlock || format == vk::Format::eBc5SnormBlock;
+        bool isAstc = format >= vk::Format::eAstc4x4UnormBlock && format <= vk::Format::eAstc12x12SrgbBlock;
+
+        if (!(isBc && bcTexturesSupported) && !(isAstc && astcTexturesSupported)) return false;
+
+        return static_cast<bool>(physicalDevice.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+    }
+
+    // one opaque white texel, every device can sample R8G8B8A8 with optimal tiling
+    Ktx2File defaultTextureSource(std::string const& path) {
+        return {
+            .path = path,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .width = 1,
+            .height = 1,
+            .builtinWhite = true,
+            .levels = { { .byteOffset = 0, .byteLength = 4 } }
+        };
+    }
+
+    void loadTexture(std::string const& path) {
+        if (textures.size() >= MAX_STREAMED_TEXTURES) {
+            throw std::runtime_error("Too many streamed textures");
+        }
+
+        Ktx2File source = readKtx2Header(path);
+        if (source.levels.empty()) {
+            std::cout << "Texture " << path << " is supercompressed or has no uploadable format (" << vk::to_string(source.format) << "), using a 1x1 default texture\n";
+            source = defaultTextureSource(path);
+        } else if (isTextureFormatSupported(source.format)) {
+            std::cout << "Loaded KTX2 header of " << path << ", " << source.width << " by " << source.height << " with " << source.levels.size() << " levels in " << vk::to_string(source.format) << '\n';
+        } else {
+            std::cout << "Texture format " << vk::to_string(source.format) << " not supported by device, using a 1x1 default texture for " << path << '\n';
+            source = defaultTextureSource(path);
+        }
+
+        uint32_t index = static_cast<uint32_t>(textures.size());
+        textures.emplace_back();
+        StreamedTexture& texture = textures.back();
+        texture.source = std::move(source);
+        texture.feedbackSlot = index;
+
+        uint32_t levelCount = static_cast<uint32_t>(texture.source.levels.size());
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+
+        texture.sparse = sparseTexturesSupported && !physicalDevice.getSparseImageFormatProperties(
+            texture.source.format, vk::ImageType::e2D, vk::SampleCountFlagBits::e1, usage, vk::ImageTiling::eOptimal).empty();
+
+        vk::ImageCreateInfo imageInfo = {
+            .flags = texture.sparse ? vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency : vk::ImageCreateFlags(),
+            .imageType = vk::ImageType::e2D,
+            .format = texture.source.format,
+            .extent = { texture.source.width, texture.source.height, 1 },
+            .mipLevels = levelCount,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = usage,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined
+        };
+        texture.image = vk::raii::Image(device, imageInfo);
+
+        vk::MemoryRequirements requirements = texture.image.getMemoryRequirements();
+        texture.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        texture.residencyId = registerStreamable(memoryProperties.memoryTypes[texture.memoryTypeIndex].heapIndex);
+
+        for (uint32_t i = 0; i < levelCount; ++i) {
+            texture.levelMemory.emplace_back(nullptr);
+        }
+
+        vk::SparseImageMemoryRequirements colorRequirements{};
+        if (texture.sparse) {
+            bool foundColorRequirements = false;
+            for (vk::SparseImageMemoryRequirements const& r : texture.image.getSparseMemoryRequirements()) {
+                if (r.formatProperties.aspectMask & vk::ImageAspectFlagBits::eColor) {
+                    colorRequirements = r;
+                    foundColorRequirements = true;
+                    break;
+                }
+            }
+            if (!foundColorRequirements) {
+                throw std::runtime_error("No sparse color requirements for texture:" + path);
+            }
+
+            texture.sparseBlockSize = requirements.alignment;
+            texture.sparseGranularity = colorRequirements.formatProperties.imageGranularity;
+            texture.mipTailFirstLevel = std::min(colorRequirements.imageMipTailFirstLod, levelCount);
+            texture.minResidentLevel = std::min(texture.mipTailFirstLevel, levelCount - 1);
+        } else {
+            texture.mipTailFirstLevel = 0;
+            texture.minResidentLevel = 0;
+        }
+
+        std::vector<vk::SparseMemoryBind> tailBinds;
+        std::vector<vk::SparseImageOpaqueMemoryBindInfo> opaqueBindInfos;
+        std::vector<vk::SparseImageMemoryBind> levelBinds;
+        std::vector<vk::SparseImageMemoryBindInfo> levelBindInfos;
+
+        if (texture.sparse) {
+            if (texture.mipTailFirstLevel < levelCount) {
+                vk::MemoryAllocateInfo tailInfo = {
+                    .allocationSize = colorRequirements.imageMipTailSize,
+                    .memoryTypeIndex = texture.memoryTypeIndex
+                };
+                texture.tailMemory = vk::raii::DeviceMemory(device, tailInfo);
+                addResidentBytes(texture.residencyId, colorRequirements.imageMipTailSize);
+
+                tailBinds.push_back({
+                    .resourceOffset = colorRequirements.imageMipTailOffset,
+                    .size = colorRequirements.imageMipTailSize,
+                    .memory = *texture.tailMemory,
+                    .memoryOffset = 0
+                });
+                opaqueBindInfos.push_back({ .image = *texture.image, .bindCount = 1, .pBinds = tailBinds.data() });
+                std::cout << "Binding mip tail of " << toMiB(colorRequirements.imageMipTailSize) << " MiB from level " << texture.mipTailFirstLevel << '\n';
+            }
+
+            levelBinds.reserve(texture.mipTailFirstLevel - texture.minResidentLevel);
+            for (uint32_t level = texture.minResidentLevel; level < texture.mipTailFirstLevel; ++level) {
+                levelBinds.push_back(makeTextureLevelResident(texture, level));
+            }
+            for (vk::SparseImageMemoryBind const& bind : levelBinds) {
+                levelBindInfos.push_back({ .image = *texture.image, .bindCount = 1, .pBinds = &bind });
+            }
+
+            streamableResources.at(texture.residencyId).evictStep = [this, index]() -> vk::DeviceSize {
+                return evictTextureLevel(textures[index]);
+            };
+        } else {
+            vk::MemoryAllocateInfo allocateInfo = {
+                .allocationSize = requirements.size,
+                .memoryTypeIndex = texture.memoryTypeIndex
+            };
+            texture.tailMemory = vk::raii::DeviceMemory(device, allocateInfo);
+            texture.image.bindMemory(*texture.tailMemory, 0);
+            addResidentBytes(texture.residencyId, requirements.size);
+        }
+
+        uploadInitialTextureLevels(index, levelBindInfos, opaqueBindInfos);
+        texture.residentLevel = texture.minResidentLevel;
+
+        vk::ImageViewCreateInfo viewInfo = {
+            .image = *texture.image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = texture.source.format,
+            .subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1 }
+        };
+        texture.view = vk::raii::ImageView(device, viewInfo);
+
+        vk::DescriptorSetAllocateInfo setInfo = {
+            .descriptorPool = descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &*textureSetLayout
+        };
+        texture.descriptorSet = std::move(vk::raii::DescriptorSets(device, setInfo).front());
+        updateTextureSampler(texture);
+
+        std::cout << "Texture " << path << " created " << (texture.sparse ? "sparse" : "fully resident") << " with levels " << texture.residentLevel << " and coarser resident\n";
+    }
+
+    vk::Extent2D textureLevelExtent(StreamedTexture const& texture, uint32_t level) {
+        return { std::max(1u, texture.source.width >> level), std::max(1u, texture.source.height >> level) };
+    }
+
+    uint32_t textureLevelBlockRows(StreamedTexture const& texture, uint32_t level) {
+        uint32_t blockHeight = vk::blockExtent(texture.source.format)[1];
+        return (textureLevelExtent(texture, level).height + blockHeight - 1) / blockHeight;
+    }
+
+    vk::DeviceSize textureBlockRowBytes(StreamedTexture const& texture, uint32_t level) {
+        uint32_t blockWidth = vk::blockExtent(texture.source.format)[0];
+        vk::DeviceSize blocksWide = (textureLevelExtent(texture, level).width + blockWidth - 1) / blockWidth;
+        return blocksWide * vk::blockSize(texture.source.format);
+    }
+
+    vk::DeviceSize sparseLevelBytes(StreamedTexture const& texture, uint32_t level) {
+        vk::Extent2D extent = textureLevelExtent(texture, level);
+        vk::DeviceSize blocksWide = (extent.width + texture.sparseGranularity.width - 1) / texture.sparseGranularity.width;
+        vk::DeviceSize blocksHigh = (extent.height + texture.sparseGranularity.height - 1) / texture.sparseGranularity.height;
+        return blocksWide * blocksHigh * texture.sparseBlockSize;
+    }
+
+    // allocates memory for a sparse level and returns its bind, the caller batches binds into one bindSparse
+    vk::SparseImageMemoryBind makeTextureLevelResident(StreamedTexture& texture, uint32_t level) {
+        vk::DeviceSize bytes = sparseLevelBytes(texture, level);
+
+        vk::MemoryAllocateInfo allocateInfo = {
+            .allocationSize = bytes,
+            .memoryTypeIndex = texture.memoryTypeIndex
+        };
+        texture.levelMemory[level] = vk::raii::DeviceMemory(device, allocateInfo);
+        addResidentBytes(texture.residencyId, bytes);
+
+        vk::Extent2D extent = textureLevelExtent(texture, level);
+        return {
+            .subresource = { vk::ImageAspectFlagBits::eColor, level, 0 },
+            .offset = { 0, 0, 0 },
+            .extent = { extent.width, extent.height, 1 },
+            .memory = *texture.levelMemory[level],
+            .memoryOffset = 0
+        };
+    }
+
+    // the first band of a level discards its old contents, later ones keep the bands already copied
+    void recordTextureBandUpload(vk::raii::CommandBuffer const& commands, StreamedTexture const& texture, TextureUpload const& upload) {
+        vk::Extent2D extent = textureLevelExtent(texture, upload.level);
+        uint32_t blockHeight = vk::blockExtent(texture.source.format)[1];
+        uint32_t firstRow = upload.firstBlockRow * blockHeight;
+        vk::BufferImageCopy region = {
+            .bufferOffset = upload.staging.offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = { vk::ImageAspectFlagBits::eColor, upload.level, 0, 1 },
+            .imageOffset = { 0, static_cast<int32_t>(firstRow), 0 },
+            .imageExtent = { extent.width, std::min(upload.blockRows * blockHeight, extent.height - firstRow), 1 }
+        };
+
+        bool firstBand = upload.firstBlockRow == 0;
+        recordTextureLevelBarrier(commands, *texture.image, upload.level, 1,
+            firstBand ? vk::ImageLayout::eUndefined : vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferDstOptimal,
+            {}, vk::AccessFlagBits2::eTransferWrite,
+            firstBand ? vk::PipelineStageFlagBits2::eTopOfPipe : vk::PipelineStageFlagBits2::eFragmentShader, vk::PipelineStageFlagBits2::eTransfer);
+        commands.copyBufferToImage(*stagingRingBuffer, *texture.image, vk::ImageLayout::eTransferDstOptimal, region);
+        recordTextureLevelBarrier(commands, *texture.image, upload.level, 1,
+            vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::AccessFlagBits2::eTransferWrite, vk::AccessFlagBits2::eShaderSampledRead,
+            vk::PipelineStageFlagBits2::eTransfer, vk::PipelineStageFlagBits2::eFragmentShader);
+    }
+
+    // uploads every level from minResidentLevel down, coarsest first, one staging ring fill per batch so neither a level
+    // nor the whole chain has to fit in the ring. nothing can be drawn without these levels, so each batch is waited on
+    void uploadInitialTextureLevels(uint32_t index, std::vector<vk::SparseImageMemoryBindInfo> const& levelBindInfos, std::vector<vk::SparseImageOpaqueMemoryBindInfo> const& opaqueBindInfos) {
+        StreamedTexture& texture = textures[index];
+        uint32_t levelCount = static_cast<uint32_t>(texture.source.levels.size());
+        std::vector<TextureUpload> batch;
+        uint32_t batchCount = 0;
+
+        std::function<void()> submitBatch = [&]() {
+            textureUploadCommands.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+            if (batchCount == 0) {
+                // every level starts shader readable so the descriptor layout holds for the whole view, minLod keeps unloaded levels unsampled
+                recordTextureLevelBarrier(textureUploadCommands, *texture.image, 0, levelCount,
+                    vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal,
+                    {}, vk::AccessFlagBits2::eShaderSampledRead,
+                    vk::PipelineStageFlagBits2::eTopOfPipe, vk::PipelineStageFlagBits2::eFragmentShader);
+            }
+            for (TextureUpload& upload : batch) {
+                upload.read.get();
+                recordTextureBandUpload(textureUploadCommands, texture, upload);
+            }
+            textureUploadCommands.end();
+
+            // the sparse binds go with the first batch, every later one only copies
+            submitTextureUploadBatch(batchCount == 0 ? levelBindInfos : std::vector<vk::SparseImageMemoryBindInfo>(),
+                batchCount == 0 ? opaqueBindInfos : std::vector<vk::SparseImageOpaqueMemoryBindInfo>());
+            while (vk::Result::eTimeout == device.waitForFences(*textureUploadDone, vk::True, UINT64_MAX));
+
+            for (TextureUpload const& upload : batch) {
+                releaseStaging(upload.staging);
+            }
+            batch.clear();
+            batchCount++;
+        };
+
+        for (uint32_t level = levelCount; level-- > texture.minResidentLevel;) {
+            uint32_t blockRows = textureLevelBlockRows(texture, level);
+
+            for (uint32_t firstBlockRow = 0; firstBlockRow < blockRows;) {
+                TextureUpload upload;
+                if (!reserveTextureBand(index, level, firstBlockRow, STAGING_RING_SIZE, upload)) {
+                    if (batch.empty()) {
+                        throw std::runtime_error("A single block row of texture level " + std::to_string(level) + " is larger than the staging ring:" + texture.source.path);
+                    }
+                    submitBatch(); // ring is full, retry the band once it has drained
+                    continue;
+                }
+
+                firstBlockRow += upload.blockRows;
+                batch.push_back(std::move(upload));
+            }
+        }
+
+        if (!batch.empty() || batchCount == 0) {
+            submitBatch();
+        }
+
+        std::cout << "Uploaded initial levels of " << texture.source.path << " in " << batchCount << (batchCount == 1 ? " batch\n" : " batches\n");
+    }
+
+    // sparse binds carry no ordering against submits on the same queue, so the recorded upload commands wait on
+    // textureBindDone and completion is tracked with textureUploadDone rather than by idling the queue
+    void submitTextureUploadBatch(std::vector<vk::SparseImageMemoryBindInfo> const& levelBindInfos, std::vector<vk::SparseImageOpaqueMemoryBindInfo> const& opaqueBindInfos) {
+        bool hasBinds = !levelBindInfos.empty() || !opaqueBindInfos.empty();
+
+        if (hasBinds) {
+            vk::BindSparseInfo bindInfo = {
+                .imageOpaqueBindCount = static_cast<uint32_t>(opaqueBindInfos.size()),
+                .pImageOpaqueBinds = opaqueBindInfos.data(),
+                .imageBindCount = static_cast<uint32_t>(levelBindInfos.size()),
+                .pImageBinds = levelBindInfos.data(),
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &*textureBindDone
+            };
+            graphicsQueue.bindSparse(bindInfo);
+        }
+
+        vk::PipelineStageFlags waitDestinationStageMask(vk::PipelineStageFlagBits::eAllCommands);
+        vk::SubmitInfo submitInfo = {
+            .waitSemaphoreCount = hasBinds ? 1u : 0u,
+            .pWaitSemaphores = &*textureBindDone,
+            .pWaitDstStageMask = &waitDestinationStageMask,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &*textureUploadCommands
+        };
+        device.resetFences(*textureUploadDone);
+        graphicsQueue.submit(submitInfo, *textureUploadDone);
+    }
+
+    // allocations are released in the order they were reserved, so the ring only needs a head and a tail
+    bool reserveStaging(vk::DeviceSize bytes, StagingAllocation& allocation) {
+        vk::DeviceSize start = (stagingHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+        if (stagingAllocations == 0) {
+            stagingHead = 0;
+            stagingTail = 0;
+            start = 0;
+            if (bytes > STAGING_RING_SIZE) return false;
+        } else if (stagingHead > stagingTail) {
+            if (start + bytes > STAGING_RING_SIZE) {
+                if (bytes > stagingTail) return false;
+                start = 0; // wrap, the tail is past the front of the ring
+            }
+        } else if (start + bytes > stagingTail) {
+            return false;
+        }
+
+        allocation = { .offset = start, .end = start + bytes };
+        stagingHead = allocation.end;
+        stagingAllocations++;
+        return true;
+    }
+
+    void releaseStaging(StagingAllocation const& allocation) {
+        stagingTail = allocation.end;
+        stagingAllocations--;
+    }
+
+    // minLod is baked into the sampler, so it is recreated and rewritten whenever the resident range changes
+    void updateTextureSampler(StreamedTexture& texture) {
+        vk::SamplerCreateInfo samplerInfo = {
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eLinear,
+            .addressModeU = vk::SamplerAddressMode::eRepeat,
+            .addressModeV = vk::SamplerAddressMode::eRepeat,
+            .addressModeW = vk::SamplerAddressMode::eRepeat,
+            .minLod = static_cast<float>(texture.residentLevel),
+            .maxLod = vk::LodClampNone
+        };
+        texture.sampler = vk::raii::Sampler(device, samplerInfo);
+
+        vk::DescriptorImageInfo imageInfo = {
+            .sampler = *texture.sampler,
+            .imageView = *texture.view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+        };
+        vk::DescriptorBufferInfo feedbackInfo = {
+            .buffer = *textureFeedbackBuffer,
+            .offset = 0,
+            .range = vk::WholeSize
+        };
+        std::array<vk::WriteDescriptorSet, 2> writes = {{
+            {
+                .dstSet = *texture.descriptorSet,
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo = &imageInfo
+            },
+            {
+                .dstSet = *texture.descriptorSet,
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &feedbackInfo
+            }
+        }};
+        device.updateDescriptorSets(writes, {});
+    }
+
+    void recordTextureLevelBarrier(
+        vk::raii::CommandBuffer const& commands,
+        vk::Image image,
+        uint32_t baseLevel,
+        uint32_t levelCount,
+        vk::ImageLayout oldLayout,
+        vk::ImageLayout newLayout,
+        vk::AccessFlags2 srcAccessMask,
+        vk::AccessFlags2 dstAccessMask,
+        vk::PipelineStageFlags2 srcStageMask,
+        vk::PipelineStageFlags2 dstStageMask) {
+
+        vk::ImageMemoryBarrier2 barrier = {
+            .srcStageMask = srcStageMask,
+            .srcAccessMask = srcAccessMask,
+            .dstStageMask = dstStageMask,
+            .dstAccessMask = dstAccessMask,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = baseLevel,
+                .levelCount = levelCount,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+
+        vk::DependencyInfo dependencyInfo = {
+            .dependencyFlags = {},
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &barrier
+        };
+
+        commands.pipelineBarrier2(dependencyInfo);
+    }
+
+    void createTextureUploadResources() {
+        vk::BufferCreateInfo bufferInfo = {
+            .size = STAGING_RING_SIZE,
+            .usage = vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive
+        };
+        stagingRingBuffer = vk::raii::Buffer(device, bufferInfo);
+
+        vk::MemoryRequirements requirements = stagingRingBuffer.getMemoryRequirements();
+        vk::MemoryAllocateInfo allocateInfo = {
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+        };
+        stagingRingMemory = vk::raii::DeviceMemory(device, allocateInfo);
+        stagingRingBuffer.bindMemory(*stagingRingMemory, 0);
+        stagingRing = static_cast<char*>(stagingRingMemory.mapMemory(0, STAGING_RING_SIZE));
+
+        vk::CommandBufferAllocateInfo commandBuffersInfo = {
+            .commandPool = commandPool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1
+        };
+        textureUploadCommands = std::move(vk::raii::CommandBuffers(device, commandBuffersInfo).front());
+
+        textureBindDone = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo());
+        textureUploadDone = vk::raii::Fence(device, vk::FenceCreateInfo());
+
+        std::cout << "Created " << toMiB(STAGING_RING_SIZE) << " MiB persistently mapped staging ring, upload command buffer, bind semaphore and upload fence\n";
+    }
+
+    void createDescriptorPool() {
+        vk::DescriptorPoolSize poolSizes[] = {
+            { .type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = MAX_STREAMED_TEXTURES },
+            { .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = MAX_STREAMED_TEXTURES }
+        };
+
+        vk::DescriptorPoolCreateInfo poolInfo = {
+            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+            .maxSets = MAX_STREAMED_TEXTURES,
+            .poolSizeCount = 2,
+            .pPoolSizes = poolSizes
+        };
+
+        descriptorPool = vk::raii::DescriptorPool(device, poolInfo);
+        std::cout << "Created descriptor pool for " << MAX_STREAMED_TEXTURES << " texture sets\n";
+    }
+
+    void createTextureFeedbackBuffer() {
+        vk::DeviceSize size = MAX_STREAMED_TEXTURES * sizeof(uint32_t);
+
+        vk::BufferCreateInfo bufferInfo = {
+            .size = size,
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+            .sharingMode = vk::SharingMode::eExclusive
+        };
+        textureFeedbackBuffer = vk::raii::Buffer(device, bufferInfo);
+
+        vk::MemoryRequirements requirements = textureFeedbackBuffer.getMemoryRequirements();
+        vk::MemoryAllocateInfo allocateInfo = {
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+        };
+        textureFeedbackMemory = vk::raii::DeviceMemory(device, allocateInfo);
+        textureFeedbackBuffer.bindMemory(*textureFeedbackMemory, 0);
+
+        textureFeedback = static_cast<uint32_t*>(textureFeedbackMemory.mapMemory(0, size));
+        std::fill(textureFeedback, textureFeedback + MAX_STREAMED_TEXTURES, TEXTURE_FEEDBACK_NONE);
+        std::cout << "Created host visible texture feedback buffer with " << MAX_STREAMED_TEXTURES << " slots\n";
+    }
+
+    void createDescriptorSetLayout() {
+        vk::DescriptorSetLayoutBinding bindings[] = {
+            {
+                .binding = 0,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eFragment
+            },
+            {
+                .binding = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eFragment
+            }
+        };
+
+        vk::DescriptorSetLayoutCreateInfo layoutInfo = {
+            .bindingCount = 2,
+            .pBindings = bindings
+        };
+
+        textureSetLayout = vk::raii::DescriptorSetLayout(device, layoutInfo);
+        std::cout << "Created texture descriptor set layout with a sampled texture and the feedback buffer\n\n";
     }
 
     void createSyncObjects() {
@@ -124,10 +1005,9 @@ private:
         return buffer;
     }
 
-    void createGraphicsPipeline() {
-        std::cout << "Creating graphics pipeline:\n";
+    void createGraphicsPipeline(std::vector<char> const& shaderBytecode, std::ostream& log) {
+        log << "Creating graphics pipeline:\n";
 
-        std::vector<char> shaderBytecode = readBinaryFile(R"(shaders\slang.spv)");
         vk::ShaderModuleCreateInfo moduleInfo = {
             .codeSize = shaderBytecode.size() * sizeof(char),
             .pCode = reinterpret_cast<const uint32_t*>(shaderBytecode.data()),
@@ -147,14 +1027,14 @@ private:
         };
 
         vk::PipelineShaderStageCreateInfo shaderStages[] = { vertex, fragment };
-        std::cout << "Created programmable graphics pipeline stages of vertex and fragment shading create info\n";
+        log << "Created programmable graphics pipeline stages of vertex and fragment shading create info\n";
 
         vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
 
         vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
             .topology = vk::PrimitiveTopology::eTriangleList
         };
-        std::cout << "Created vertex input assembler create info with triangle list\n";
+        log << "Created vertex input assembler create info with triangle list\n";
 
         vk::PipelineViewportStateCreateInfo viewportInfo = {
             .viewportCount = 1,
@@ -171,19 +1051,19 @@ private:
             .depthBiasSlopeFactor = 1.0f,
             .lineWidth = 1.0f
         };
-        std::cout << "Created rasterization create info with fill, front face clockwise, back culling\n";
+        log << "Created rasterization create info with fill, front face clockwise, back culling\n";
 
         vk::PipelineMultisampleStateCreateInfo multisamplingInfo = { 
             .rasterizationSamples = vk::SampleCountFlagBits::e1, 
             .sampleShadingEnable = vk::False 
         };
-        std::cout << "Skipped multisamping\n";
+        log << "Skipped multisamping\n";
 
         vk::PipelineColorBlendAttachmentState colorBlendAttachmentInfo = { 
             .blendEnable = vk::False,
             .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA 
         };
-        std::cout << "Color blend attachment set to false, fragments overwrite each other\n";
+        log << "Color blend attachment set to false, fragments overwrite each other\n";
 
         vk::PipelineColorBlendStateCreateInfo colorBlendingInfo = { 
             .logicOpEnable = vk::False,
@@ -191,7 +1071,7 @@ private:
             .attachmentCount = 1, 
             .pAttachments = &colorBlendAttachmentInfo
         };
-        std::cout << "Color blend attachment info created, one with no logic\n";
+        log << "Color blend attachment info created, one with no logic\n";
 
 
         std::vector<vk::DynamicState> dynamicStates = {
@@ -202,21 +1082,27 @@ private:
             .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
             .pDynamicStates = dynamicStates.data()
         };
-        std::cout << "2 dynamic states created, viewport and scissor\n";
+        log << "2 dynamic states created, viewport and scissor\n";
 
-        vk::raii::PipelineLayout pipelineLayout = nullptr;
+        vk::PushConstantRange feedbackSlotRange = {
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+            .offset = 0,
+            .size = sizeof(uint32_t)
+        };
         vk::PipelineLayoutCreateInfo pipelineLayoutInfo = { 
-            .setLayoutCount = 0, 
-            .pushConstantRangeCount = 0 
+            .setLayoutCount = 1, 
+            .pSetLayouts = &*textureSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &feedbackSlotRange
         };
         pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
-        std::cout << "Null pipeline layout state created\n";
+        log << "Pipeline layout created with the texture set and a feedback slot push constant\n";
 
         vk::PipelineRenderingCreateInfo attachmentInfo = {
             .colorAttachmentCount = 1,
             .pColorAttachmentFormats = &swapchainFormat.format
         };
-        std::cout << "Pipeline rendering create info created with one color attachment and same format as swapchain\n";
+        log << "Pipeline rendering create info created with one color attachment and same format as swapchain\n";
 
         vk::GraphicsPipelineCreateInfo pipelineInfo = {
             .pNext = &attachmentInfo,
@@ -234,7 +1120,7 @@ private:
         };
 
         graphicsPipeline = vk::raii::Pipeline(device, nullptr, pipelineInfo);
-        std::cout << "Created graphics pipeline, GRAPHICS PIPELINE CREATION FINISHED\n\n";
+        log << "Created graphics pipeline, GRAPHICS PIPELINE CREATION FINISHED\n\n";
     }
 
     void createSwapchainImageViews() {
@@ -255,14 +1141,9 @@ private:
         std::cout << "SWAPCHAIN IMAGE VIEW CREATION FINISHED\n\n";
     }
 
-    void createSwapchain() {
-        std::cout << "CREATING SWAPCHAIN:\n";
-
-        vk::SurfaceCapabilitiesKHR capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
-        std::vector<vk::SurfaceFormatKHR> formats = physicalDevice.getSurfaceFormatsKHR(surface);
-        std::vector<vk::PresentModeKHR> presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
-
-        uint32_t imageCount = ~0;
+    // split from createSwapchain since the pipeline only needs the format and can start compiling before the swapchain exists
+    void chooseSwapchainFormat() {
+        std::vector<vk::SurfaceFormatKHR> const& formats = deviceCapabilities.surfaceFormats;
 
         bool foundWantedFormat = false;
         for(vk::SurfaceFormatKHR const& f : formats) {
@@ -277,6 +1158,15 @@ private:
             swapchainFormat = formats[0];
             std::cout << "Didn't find best surface format, defaulting...\n";
         }
+    }
+
+    void createSwapchain() {
+        std::cout << "CREATING SWAPCHAIN:\n";
+
+        vk::SurfaceCapabilitiesKHR capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
+        std::vector<vk::PresentModeKHR> const& presentModes = deviceCapabilities.presentModes;
+
+        uint32_t imageCount = ~0;
 
         bool foundWantedPresentMode = false;
         for (vk::PresentModeKHR const& pm : presentModes) {
@@ -340,16 +1230,18 @@ private:
     void createDevice() {
         std::cout << "CREATING LOGICAL DEVICE:\n";
 
-        std::vector<vk::QueueFamilyProperties> qfProperties = physicalDevice.getQueueFamilyProperties();
+        std::vector<vk::QueueFamilyProperties> const& qfProperties = deviceCapabilities.queueFamilies;
 
-        for(uint32_t i = 0; i < qfProperties.size(); ++i) {
-            if ((qfProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) &&
-                physicalDevice.getSurfaceSupportKHR(i, *surface)) {
-                graphicsQfIndex = i;
-                std::cout << "Graphics queue family that supports presenting to surface at index " << graphicsQfIndex << " found in " << physicalDevice.getProperties().deviceName << '\n';
-                break;
-            }
-        }
+        graphicsQfIndex = deviceCapabilities.presentQueueFamily;
+        std::cout << "Graphics queue family that supports presenting to surface at index " << graphicsQfIndex << " found in " << deviceCapabilities.properties.deviceName << '\n';
+
+        vk::PhysicalDeviceFeatures const& supportedFeatures = deviceCapabilities.features;
+        bcTexturesSupported = supportedFeatures.textureCompressionBC;
+        astcTexturesSupported = supportedFeatures.textureCompressionASTC_LDR;
+        sparseTexturesSupported = supportedFeatures.sparseBinding && supportedFeatures.sparseResidencyImage2D &&
+            (qfProperties[graphicsQfIndex].queueFlags & vk::QueueFlagBits::eSparseBinding);
+        std::cout << "BC textures " << (bcTexturesSupported ? "supported" : "unsupported") << ", ASTC textures " << (astcTexturesSupported ? "supported" : "unsupported") << '\n';
+        std::cout << "Sparse texture residency " << (sparseTexturesSupported ? "supported, textures will stream mip levels" : "unsupported, textures will be fully resident") << '\n';
 
         float priority = 0.5f;
         vk::DeviceQueueCreateInfo queueCreateInfo = {
@@ -362,21 +1254,36 @@ private:
         vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> featureChain = {
             {},
             {.shaderDrawParameters = true},
-            {.synchronization2 = true, .dynamicRendering = true },    
+            {.shaderDemoteToHelperInvocation = true, .synchronization2 = true, .dynamicRendering = true },    
             {.extendedDynamicState = true }
         };
+        vk::PhysicalDeviceFeatures& coreFeatures = featureChain.get<vk::PhysicalDeviceFeatures2>().features;
+        coreFeatures.fragmentStoresAndAtomics = true;
+        coreFeatures.textureCompressionBC = bcTexturesSupported;
+        coreFeatures.textureCompressionASTC_LDR = astcTexturesSupported;
+        coreFeatures.sparseBinding = sparseTexturesSupported;
+        coreFeatures.sparseResidencyImage2D = sparseTexturesSupported;
         std::cout << "Made structure chain with wanted features" << '\n';
 
+        std::vector<const char*> enabledPhyDeviceExtensions = requiredPhyDeviceExtensions;
+        for (const char* optionalExtension : optionalPhyDeviceExtensions) {
+            if (deviceCapabilities.extensions.contains(optionalExtension)) {
+                enabledPhyDeviceExtensions.push_back(optionalExtension);
+                std::cout << "Optional extension supported, enabling:" << optionalExtension << '\n';
+            }
+        }
+        memoryBudgetSupported = deviceCapabilities.extensions.contains(vk::EXTMemoryBudgetExtensionName);
+
         vk::DeviceCreateInfo deviceCreateInfo = {
             .pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>(),
             .queueCreateInfoCount = 1,
             .pQueueCreateInfos = &queueCreateInfo,
-            .enabledExtensionCount = static_cast<uint32_t>(requiredPhyDeviceExtensions.size()),
-            .ppEnabledExtensionNames = requiredPhyDeviceExtensions.data()
+            .enabledExtensionCount = static_cast<uint32_t>(enabledPhyDeviceExtensions.size()),
+            .ppEnabledExtensionNames = enabledPhyDeviceExtensions.data()
         };
 
         device = vk::raii::Device(physicalDevice, deviceCreateInfo);
-        std::cout << "Logical device created for " << physicalDevice.getProperties().deviceName << '\n';
+        std::cout << "Logical device created for " << deviceCapabilities.properties.deviceName << '\n';
 
         graphicsQueue = vk::raii::Queue(device, graphicsQfIndex, 0);
         std::cout << "Queue object created at qf index " << graphicsQfIndex << " and queue 0" << '\n';
@@ -384,6 +1291,46 @@ private:
         std::cout << "LOGICAL DEVICE CREATION FINISHED\n\n";
     }
 
+    DeviceCapabilities queryDeviceCapabilities(vk::raii::PhysicalDevice const& d) {
+        DeviceCapabilities capabilities;
+        vk::StructureChain<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties> properties = d.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+        vk::PhysicalDeviceSubgroupProperties const& subgroup = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+        capabilities.properties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+        capabilities.fragmentSubgroupArithmetic = (subgroup.supportedStages & vk::ShaderStageFlagBits::eFragment) &&
+            (subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eArithmetic) &&
+            (subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eBasic);
+        capabilities.memoryProperties = d.getMemoryProperties();
+        capabilities.queueFamilies = d.getQueueFamilyProperties();
+
+        for (vk::ExtensionProperties const& eP : d.enumerateDeviceExtensionProperties()) {
+            capabilities.extensions.insert(eP.extensionName.data());
+        }
+
+        vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> features = d.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+        capabilities.features = features.get<vk::PhysicalDeviceFeatures2>().features;
+        capabilities.shaderDrawParameters = features.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters;
+        capabilities.dynamicRendering = features.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering;
+        capabilities.synchronization2 = features.get<vk::PhysicalDeviceVulkan13Features>().synchronization2;
+        capabilities.shaderDemoteToHelperInvocation = features.get<vk::PhysicalDeviceVulkan13Features>().shaderDemoteToHelperInvocation;
+        capabilities.extendedDynamicState = features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
+
+        for (uint32_t i = 0; i < capabilities.queueFamilies.size(); ++i) {
+            if ((capabilities.queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics) && d.getSurfaceSupportKHR(i, *surface)) {
+                capabilities.hasPresentQueueFamily = true;
+                capabilities.presentQueueFamily = i;
+                break;
+            }
+        }
+
+        // a device that can't present to the surface is never picked, so its formats and present modes aren't worth querying
+        if (capabilities.hasPresentQueueFamily) {
+            capabilities.surfaceFormats = d.getSurfaceFormatsKHR(surface);
+            capabilities.presentModes = d.getSurfacePresentModesKHR(surface);
+        }
+
+        return capabilities;
+    }
+
     void pickPhysicalDevice() {
         std::cout << "PICKING PHYSICAL DEVICE:\n";
 
@@ -391,79 +1338,74 @@ private:
 
         for(vk::raii::PhysicalDevice const& d : phyDevices) {  
             uint32_t suitability = 0;
+            DeviceCapabilities capabilities = queryDeviceCapabilities(d);
+            std::string name = capabilities.properties.deviceName.data();
 
-            if (d.getProperties().apiVersion >= VK_API_VERSION_1_3) {
+            if (capabilities.properties.apiVersion >= VK_API_VERSION_1_3) {
                 suitability++;
-                std::cout << d.getProperties().deviceName << ":" << "Vulkan version supported" << '\n';
+                std::cout << name << ":" << "Vulkan version supported" << '\n';
             }
 
-            std::vector<vk::QueueFamilyProperties> qfProperties = d.getQueueFamilyProperties();
-
             bool hasGraphicsQueueFamily = false;
-            for(vk::QueueFamilyProperties const& qf : qfProperties) {
+            for(vk::QueueFamilyProperties const& qf : capabilities.queueFamilies) {
                 if(qf.queueFlags & vk::QueueFlagBits::eGraphics) {
-                    std::cout << d.getProperties().deviceName << ":" << "Graphics queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Graphics queue family with " << qf.queueCount << " queues found" << '\n';
                     hasGraphicsQueueFamily = true;
                 } else if(qf.queueFlags & vk::QueueFlagBits::eCompute) {
-                    std::cout << d.getProperties().deviceName << ":" << "Compute queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Compute queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eDataGraphARM) {
-                    std::cout << d.getProperties().deviceName << ":" << "Data graph queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Data graph queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eOpticalFlowNV) {
-                    std::cout << d.getProperties().deviceName << ":" << "Optical flow queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Optical flow queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eProtected) {
-                    std::cout << d.getProperties().deviceName << ":" << "Protected queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Protected queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eSparseBinding) {
-                    std::cout << d.getProperties().deviceName << ":" << "Sparse binding queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Sparse binding queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eTransfer) {
-                    std::cout << d.getProperties().deviceName << ":" << "Transfer queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Transfer queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eVideoDecodeKHR) {
-                    std::cout << d.getProperties().deviceName << ":" << "Video decode queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Video decode queue family with " << qf.queueCount << " queues found" << '\n';
                 } else if (qf.queueFlags & vk::QueueFlagBits::eVideoEncodeKHR) {
-                    std::cout << d.getProperties().deviceName << ":" << "Video encode queue family with " << qf.queueCount << " queues found" << '\n';
+                    std::cout << name << ":" << "Video encode queue family with " << qf.queueCount << " queues found" << '\n';
                 } else {
-                    std::cout << d.getProperties().deviceName << ":" << "???" << '\n';
+                    std::cout << name << ":" << "???" << '\n';
                 }
             }
             if(hasGraphicsQueueFamily) {
                 suitability++;
-                std::cout << d.getProperties().deviceName << ":" << "Has graphics queue family" << '\n';
+                std::cout << name << ":" << "Has graphics queue family" << '\n';
             }
 
-            bool hasRequiredExtensions = true;
-            std::vector<vk::ExtensionProperties> extensionProperties = d.enumerateDeviceExtensionProperties();
-            for (uint32_t i = 0; i < requiredPhyDeviceExtensions.size(); ++i) {
-                bool found = false;
-
-                for(vk::ExtensionProperties const& eP : extensionProperties) {
-                    if (strcmp(eP.extensionName, requiredPhyDeviceExtensions[i]) == 0) {
-                        found = true;
-                        break;
-                    }
-                }
-
-                if(!found) hasRequiredExtensions = false;
-            }
+            bool hasRequiredExtensions = std::all_of(requiredPhyDeviceExtensions.begin(), requiredPhyDeviceExtensions.end(),
+                [&](const char* extension) { return capabilities.extensions.contains(extension); });
 
             if (hasRequiredExtensions) {
-                std::cout << d.getProperties().deviceName << ":" << "All required extensions supported" << '\n';
+                std::cout << name << ":" << "All required extensions supported" << '\n';
                 suitability++;
             }
 
-            vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> features = d.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
             bool hasRequiredFeatures = 
-                features.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
-                features.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering && 
-                features.get<vk::PhysicalDeviceVulkan13Features>().synchronization2 &&
-                features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
+                capabilities.features.fragmentStoresAndAtomics &&
+                capabilities.fragmentSubgroupArithmetic &&
+                capabilities.shaderDrawParameters &&
+                capabilities.dynamicRendering && 
+                capabilities.synchronization2 &&
+                capabilities.shaderDemoteToHelperInvocation &&
+                capabilities.extendedDynamicState;
 
             if (hasRequiredFeatures) {
-                std::cout << d.getProperties().deviceName << ":" << "Required features supported" << '\n';
+                std::cout << name << ":" << "Required features supported" << '\n';
                 suitability++;
             }
 
-            if(suitability == 4) {
+            if (capabilities.hasPresentQueueFamily) {
+                std::cout << name << ":" << "Queue family " << capabilities.presentQueueFamily << " can present to surface" << '\n';
+            }
+
+            if(suitability == 4 && capabilities.hasPresentQueueFamily && !capabilities.surfaceFormats.empty()) {
                 physicalDevice = d;
-                std::cout << "Physical device selected:" << physicalDevice.getProperties().deviceName << '\n';
+                deviceCapabilities = std::move(capabilities);
+                std::cout << "Physical device selected:" << deviceCapabilities.properties.deviceName << '\n';
                 break;
             }
         }
@@ -497,17 +1439,13 @@ private:
         };
 
         if(enableValidationLayers) {
-            std::vector<vk::LayerProperties> layerProperties = context.enumerateInstanceLayerProperties();
+            std::unordered_set<std::string> availableLayers;
+            for (vk::LayerProperties const& property : context.enumerateInstanceLayerProperties()) {
+                availableLayers.insert(property.layerName.data());
+            }
 
             for (uint32_t i = 0; i < requiredValidationLayers.size(); ++i) {
-                bool found = false;
-
-                for (vk::LayerProperties const& property : layerProperties) {
-                    if (strcmp(property.layerName, requiredValidationLayers[i]) == 0) {
-                        found = true;
-                        break;
-                    }
-                }
+                bool found = availableLayers.contains(requiredValidationLayers[i]);
 
                 if(!found) throw std::runtime_error("Required validation layer not supported:" + std::string(requiredValidationLayers[i]));
                 else std::cout << "Required validation layer supported:" + std::string(requiredValidationLayers[i]) << '\n';
@@ -517,16 +1455,13 @@ private:
         uint32_t glfwExtensionCount = 0;
         const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-        std::vector<vk::ExtensionProperties> extensionProperties = context.enumerateInstanceExtensionProperties();
-        for (uint32_t i = 0; i < glfwExtensionCount; ++i) {
-            bool found = false;
+        std::unordered_set<std::string> availableExtensions;
+        for (vk::ExtensionProperties const& property : context.enumerateInstanceExtensionProperties()) {
+            availableExtensions.insert(property.extensionName.data());
+        }
 
-            for(vk::ExtensionProperties const& property : extensionProperties) {
-                if (strcmp(property.extensionName, glfwExtensions[i]) == 0) {
-                    found = true;
-                    break;
-                }
-            }
+        for (uint32_t i = 0; i < glfwExtensionCount; ++i) {
+            bool found = availableExtensions.contains(glfwExtensions[i]);
 
             if (!found) throw std::runtime_error("Required GLFW extension not supported:" + std::string(glfwExtensions[i]));
             else std::cout << "Required GLFW extension supported:" + std::string(glfwExtensions[i]) << '\n';
@@ -558,10 +1493,285 @@ private:
         std::cout << "VULKAN INSTANCE CREATED" << "\n\n";
     }
 
+    static double toMiB(vk::DeviceSize bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+
+    void createMemoryBudgetTracking() {
+        std::cout << "SETTING UP MEMORY BUDGET TRACKING:\n";
+
+        memoryProperties = deviceCapabilities.memoryProperties;
+        heapBudgets.resize(memoryProperties.memoryHeapCount);
+
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+            heapBudgets[i].size = memoryProperties.memoryHeaps[i].size;
+            heapBudgets[i].deviceLocal = static_cast<bool>(memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+            std::cout << "Memory heap " << i << " of " << toMiB(heapBudgets[i].size) << " MiB" << (heapBudgets[i].deviceLocal ? ", device local" : "") << '\n';
+        }
+
+        if (memoryBudgetSupported) {
+            std::cout << "Using driver reported heap budgets and usage from VK_EXT_memory_budget\n";
+        } else {
+            std::cout << "VK_EXT_memory_budget not supported, estimating budgets as a fraction of heap size\n";
+        }
+
+        sampleMemoryBudget();
+        std::cout << "MEMORY BUDGET TRACKING SET UP\n\n";
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            if ((typeFilter & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Failed to find suitable memory type");
+    }
+
+    // the driver only refreshes these values on some calls, so this is sampled once per frame rather than trusted between frames
+    void sampleMemoryBudget() {
+        if (memoryBudgetSupported) {
+            vk::StructureChain<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT> properties = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            vk::PhysicalDeviceMemoryBudgetPropertiesEXT const& budgetProperties = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+            for (uint32_t i = 0; i < heapBudgets.size(); ++i) {
+                heapBudgets[i].budget = budgetProperties.heapBudget[i];
+                heapBudgets[i].usage = budgetProperties.heapUsage[i];
+            }
+        } else {
+            for (HeapBudget& heap : heapBudgets) {
+                heap.budget = static_cast<vk::DeviceSize>(heap.size * MEMORY_BUDGET_FALLBACK_FRACTION);
+                heap.usage = heap.trackedUsage;
+            }
+        }
+    }
+
+    void publishMemoryMetrics() {
+        memoryMetrics.frameIndex = frameIndex;
+        memoryMetrics.driverReported = memoryBudgetSupported;
+        memoryMetrics.heaps = heapBudgets;
+        memoryMetrics.evictedBytesLastFrame = evictedBytesLastFrame;
+        memoryMetrics.evictedBytesTotal = evictedBytesTotal;
+    }
+
+    void logMemoryMetrics(MemoryMetrics const& metrics) {
+        for (uint32_t i = 0; i < metrics.heaps.size(); ++i) {
+            HeapBudget const& heap = metrics.heaps[i];
+            double percent = heap.budget > 0 ? 100.0 * static_cast<double>(heap.usage) / static_cast<double>(heap.budget) : 0.0;
+            std::cout << "Frame " << metrics.frameIndex << ", memory heap " << i << ": " << toMiB(heap.usage) << " / " << toMiB(heap.budget) << " MiB of budget used (" << percent << "%), " << toMiB(heap.trackedUsage) << " MiB streamable" << (heap.overBudget ? ", over budget\n" : "\n");
+        }
+        std::cout << "Frame " << metrics.frameIndex << ", evicted " << toMiB(metrics.evictedBytesLastFrame) << " MiB last frame and " << toMiB(metrics.evictedBytesTotal) << " MiB in total\n";
+    }
+
+    // new residency only goes up to the low watermark, leaving the gap to the high one so streaming in and eviction don't fight
+    bool hasBudgetFor(uint32_t heapIndex, vk::DeviceSize bytes) {
+        HeapBudget const& heap = heapBudgets[heapIndex];
+        return heap.usage + bytes <= static_cast<vk::DeviceSize>(heap.budget * MEMORY_BUDGET_LOW_WATERMARK);
+    }
+
+    uint32_t registerStreamable(uint32_t heapIndex) {
+        uint32_t id = nextResidencyId++;
+        residencyLru.push_front(id);
+
+        StreamableResource& resource = streamableResources[id];
+        resource.heapIndex = heapIndex;
+        resource.lastUsedFrame = frameIndex;
+        resource.lruPosition = residencyLru.begin();
+
+        return id;
+    }
+
+    // call whenever a command buffer recorded this frame references the resource
+    void touchStreamable(uint32_t id) {
+        StreamableResource& resource = streamableResources.at(id);
+        resource.lastUsedFrame = frameIndex;
+        residencyLru.splice(residencyLru.begin(), residencyLru, resource.lruPosition);
+    }
+
+    void addResidentBytes(uint32_t id, vk::DeviceSize bytes) {
+        StreamableResource& resource = streamableResources.at(id);
+        resource.residentBytes += bytes;
+        heapBudgets[resource.heapIndex].trackedUsage += bytes;
+        heapBudgets[resource.heapIndex].usage += bytes; // keeps budget checks honest until the next sample
+    }
+
+    void removeResidentBytes(uint32_t id, vk::DeviceSize bytes) {
+        StreamableResource& resource = streamableResources.at(id);
+        bytes = std::min(bytes, resource.residentBytes);
+        resource.residentBytes -= bytes;
+        heapBudgets[resource.heapIndex].trackedUsage -= bytes;
+        heapBudgets[resource.heapIndex].usage -= std::min(bytes, heapBudgets[resource.heapIndex].usage);
+    }
+
+    // walks the lru from the least recently used end, taking one eviction step per resource and capping the bytes
+    // released per frame, so pressure lowers quality over several frames instead of stalling one
+    void evictUnderMemoryPressure() {
+        evictedBytesLastFrame = 0;
+
+        for (uint32_t heapIndex = 0; heapIndex < heapBudgets.size(); ++heapIndex) {
+            HeapBudget& heap = heapBudgets[heapIndex];
+            vk::DeviceSize target = static_cast<vk::DeviceSize>(heap.budget * MEMORY_BUDGET_LOW_WATERMARK);
+            bool evicting = heap.usage >= static_cast<vk::DeviceSize>(heap.budget * MEMORY_BUDGET_HIGH_WATERMARK);
+            std::list<uint32_t>::iterator it = residencyLru.end();
+
+            while (evicting && it != residencyLru.begin() && heap.usage > target && evictedBytesLastFrame < MAX_EVICTION_BYTES_PER_FRAME) {
+                --it;
+                StreamableResource& resource = streamableResources.at(*it);
+
+                // lru order follows lastUsedFrame, so once one resource is still in flight every remaining one is too
+                if (resource.lastUsedFrame > completedFrameIndex) break;
+                if (resource.heapIndex != heapIndex || resource.residentBytes == 0 || !resource.evictStep) continue;
+
+                vk::DeviceSize freed = resource.evictStep();
+                removeResidentBytes(*it, freed);
+                evictedBytesLastFrame += freed;
+            }
+
+            // only the transitions are logged, a heap can stay over budget for as long as someone else holds the memory
+            bool overBudget = heap.usage > target && (evicting || heap.overBudget);
+            if (overBudget != heap.overBudget) {
+                heap.overBudget = overBudget;
+                if (overBudget) std::cout << "Memory heap " << heapIndex << " over budget after evicting " << toMiB(evictedBytesLastFrame) << " MiB this frame\n";
+                else std::cout << "Memory heap " << heapIndex << " back under budget\n";
+            }
+        }
+
+        evictedBytesTotal += evictedBytesLastFrame;
+    }
+
+    // drops the finest resident level of a sparse texture, the memory is kept until the unbind has gone through the queue
+    vk::DeviceSize evictTextureLevel(StreamedTexture& texture) {
+        if (texture.uploadPending || texture.streamedBlockRows > 0 || texture.residentLevel >= texture.minResidentLevel) return 0;
+
+        uint32_t level = texture.residentLevel;
+        vk::DeviceSize bytes = sparseLevelBytes(texture, level);
+
+        texture.residentLevel++;
+        updateTextureSampler(texture);
+
+        vk::Extent2D extent = textureLevelExtent(texture, level);
+        vk::SparseImageMemoryBind unbind = {
+            .subresource = { vk::ImageAspectFlagBits::eColor, level, 0 },
+            .offset = { 0, 0, 0 },
+            .extent = { extent.width, extent.height, 1 },
+            .memory = nullptr,
+            .memoryOffset = 0
+        };
+        vk::SparseImageMemoryBindInfo unbindInfo = {
+            .image = *texture.image,
+            .bindCount = 1,
+            .pBinds = &unbind
+        };
+        vk::BindSparseInfo bindInfo = {
+            .imageBindCount = 1,
+            .pImageBinds = &unbindInfo
+        };
+        graphicsQueue.bindSparse(bindInfo);
+        retiredTextureMemory.push_back(std::move(texture.levelMemory[level]));
+        texture.levelMemory[level] = nullptr;
+
+        return bytes;
+    }
+
+    // nothing here blocks: finished batches are picked up through their fence, file reads run on workers and at
+    // most one bind plus copy batch is in flight
+    void updateTextureStreaming() {
+        finishTextureUploads();
+        requestTextureLevels();
+        submitReadyTextureUploads();
+    }
+
+    void finishTextureUploads() {
+        if (submittedTextureUploads.empty() || textureUploadDone.getStatus() != vk::Result::eSuccess) return;
+
+        for (TextureUpload const& upload : submittedTextureUploads) {
+            StreamedTexture& texture = textures[upload.textureIndex];
+            texture.uploadPending = false;
+            texture.streamedBlockRows = upload.firstBlockRow + upload.blockRows;
+            releaseStaging(upload.staging);
+
+            if (texture.streamedBlockRows == textureLevelBlockRows(texture, upload.level)) {
+                texture.streamedBlockRows = 0;
+                texture.residentLevel = upload.level;
+                updateTextureSampler(texture);
+            }
+        }
+
+        submittedTextureUploads.clear();
+    }
+
+    // asks for at most one band per texture per frame, driven by the finest level the shader wanted last frame.
+    // a level that has started streaming is finished even if it is no longer wanted
+    void requestTextureLevels() {
+        vk::DeviceSize requestedBytes = 0;
+
+        for (uint32_t i = 0; i < textures.size(); ++i) {
+            StreamedTexture& texture = textures[i];
+            uint32_t wantedLevel = textureFeedback[texture.feedbackSlot];
+            textureFeedback[texture.feedbackSlot] = TEXTURE_FEEDBACK_NONE;
+
+            if (!texture.sparse || texture.uploadPending || requestedBytes >= MAX_TEXTURE_UPLOAD_BYTES_PER_FRAME) continue;
+
+            bool levelStarted = texture.streamedBlockRows > 0;
+            if (!levelStarted && (wantedLevel == TEXTURE_FEEDBACK_NONE || wantedLevel >= texture.residentLevel)) continue;
+
+            uint32_t level = texture.residentLevel - 1;
+            uint32_t heapIndex = streamableResources.at(texture.residencyId).heapIndex;
+            if (!levelStarted && !hasBudgetFor(heapIndex, sparseLevelBytes(texture, level))) continue; // stay at the coarser level until pressure eases
+
+            TextureUpload upload;
+            if (!reserveTextureBand(i, level, texture.streamedBlockRows, MAX_TEXTURE_UPLOAD_BYTES_PER_FRAME - requestedBytes, upload)) continue; // ring is full until earlier uploads land
+
+            texture.uploadPending = true;
+            requestedBytes += upload.staging.end - upload.staging.offset;
+            pendingTextureUploads.push_back(std::move(upload));
+        }
+    }
+
+    // submits reads that have finished, in request order so staging is released in the order it was reserved
+    void submitReadyTextureUploads() {
+        if (!submittedTextureUploads.empty()) return;
+
+        while (!pendingTextureUploads.empty() && pendingTextureUploads.front().read.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            submittedTextureUploads.push_back(std::move(pendingTextureUploads.front()));
+            pendingTextureUploads.pop_front();
+        }
+        if (submittedTextureUploads.empty()) return;
+
+        std::vector<vk::SparseImageMemoryBind> levelBinds;
+        std::vector<vk::Image> boundImages;
+        levelBinds.reserve(submittedTextureUploads.size());
+
+        textureUploadCommands.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+        for (TextureUpload& upload : submittedTextureUploads) {
+            upload.read.get(); // rethrows read failures
+            StreamedTexture& texture = textures[upload.textureIndex];
+            if (upload.firstBlockRow == 0) {
+                levelBinds.push_back(makeTextureLevelResident(texture, upload.level));
+                boundImages.push_back(*texture.image);
+            }
+            recordTextureBandUpload(textureUploadCommands, texture, upload);
+        }
+        textureUploadCommands.end();
+
+        std::vector<vk::SparseImageMemoryBindInfo> levelBindInfos;
+        for (uint32_t i = 0; i < levelBinds.size(); ++i) {
+            levelBindInfos.push_back({ .image = boundImages[i], .bindCount = 1, .pBinds = &levelBinds[i] });
+        }
+
+        submitTextureUploadBatch(levelBindInfos, {});
+    }
+
     void mainLoop() {
         while(!glfwWindowShouldClose(window)) {
             glfwPollEvents();
             drawFrame();
+
+            if (frameIndex == 1) {
+                std::cout << "Time to first frame" << (startupOptions.serial ? " (serial startup)" : "") << ": " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count() << " ms\n\n";
+                if (startupOptions.benchmark) glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
         }
 
         device.waitIdle();
@@ -635,6 +1845,11 @@ private:
 
         commandBuffer.beginRendering(renderingInfo); // RECORDED
         commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline); // RECORDED
+
+        StreamedTexture const& texture = textures.front();
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, *texture.descriptorSet, {}); // RECORDED
+        commandBuffer.pushConstants<uint32_t>(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, texture.feedbackSlot); // RECORDED
+        touchStreamable(texture.residencyId);
         commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), 0.0f, 1.0f)); // RECORDED
         commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchainExtent)); // RECORDED
 
@@ -651,6 +1866,15 @@ private:
             vk::PipelineStageFlagBits2::eBottomOfPipe
         );
 
+        // make the shader's texture feedback writes visible to the host read after the frame completes
+        vk::MemoryBarrier2 feedbackBarrier = {
+            .srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+            .dstAccessMask = vk::AccessFlagBits2::eHostRead
+        };
+        commandBuffer.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &feedbackBarrier }); // RECORDED
+
         commandBuffer.end();
     }
 
@@ -659,6 +1883,15 @@ private:
         graphicsQueue.waitIdle();
         device.resetFences(*commandBufferDone);
 
+        // gpu is idle so every frame submitted so far has completed, resources last used by them can be evicted
+        completedFrameIndex = frameIndex++;
+        retiredTextureMemory.clear();
+        sampleMemoryBudget();
+        evictUnderMemoryPressure();
+        updateTextureStreaming();
+        publishMemoryMetrics();
+        if (frameIndex % MEMORY_METRICS_LOG_INTERVAL == 0) logMemoryMetrics(getMemoryMetrics());
+
         // acquire index of next image to eventually render to, once it is actually ready then signal renderReady
         std::pair<vk::Result, uint32_t> image = swapchain.acquireNextImage(UINT64_MAX, *renderReady, nullptr);
 
@@ -696,11 +1929,19 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
     HelloTriangleApplication app;
+    StartupOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--serial-startup") options.serial = true;
+        else if (argument == "--startup-benchmark") options.benchmark = true;
+        else std::cerr << "Ignoring unknown argument:" << argument << '\n';
+    }
 
     try {
-        app.run();
+        app.run(options);
     } catch (const std::exception& e) {
         std::cerr << e.what() << '\n';
         return EXIT_FAILURE;
@@ -0,0 +1,75 @@
+# Writes mipdebug.ktx2, a 256x256 BC7 sRGB texture whose mip levels are each a different solid color,
+# which makes it easy to see which levels have been streamed in.
+import struct
+
+WIDTH = 256
+HEIGHT = 256
+VK_FORMAT_BC7_SRGB_BLOCK = 146
+KHR_DF_MODEL_BC7 = 134
+
+LEVEL_COLORS = [
+    (255, 255, 255), (255, 64, 64), (255, 160, 32), (255, 255, 64), (64, 255, 64),
+    (64, 255, 255), (64, 128, 255), (160, 64, 255), (255, 64, 255),
+]
+
+
+def bc7_solid_block(r, g, b):
+    # mode 6 with equal endpoints and all indices 0, colors are 7 bits plus a shared p bit
+    bits = 1 << 6
+    offset = 7
+    for value in (r, g, b, 255):
+        for _ in range(2):
+            bits |= (value >> 1) << offset
+            offset += 7
+    bits |= 1 << offset  # p0
+    bits |= 1 << (offset + 1)  # p1
+    return bits.to_bytes(16, "little")
+
+
+def level_data(level):
+    width = max(1, WIDTH >> level)
+    height = max(1, HEIGHT >> level)
+    blocks = ((width + 3) // 4) * ((height + 3) // 4)
+    return bc7_solid_block(*LEVEL_COLORS[level]) * blocks
+
+
+def dfd():
+    block = struct.pack("<IHHBBBB4B8BHBB4BII",
+                        0, 2, 24 + 16, KHR_DF_MODEL_BC7, 1, 2, 0,
+                        3, 3, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0,
+                        0, 127, 0, 0, 0, 0, 0, 0, 0xFFFFFFFF)
+    return struct.pack("<I", 4 + len(block)) + block
+
+
+def main():
+    level_count = WIDTH.bit_length()
+    levels = [level_data(i) for i in range(level_count)]
+    descriptor = dfd()
+
+    header_size = 80 + 24 * level_count
+    dfd_offset = header_size
+    data_offset = (dfd_offset + len(descriptor) + 15) & ~15
+
+    # levels are stored smallest first, each aligned to the 16 byte block size
+    offsets = [0] * level_count
+    cursor = data_offset
+    for i in reversed(range(level_count)):
+        offsets[i] = cursor
+        cursor += (len(levels[i]) + 15) & ~15
+
+    out = bytearray(b"\xabKTX 20\xbb\r\n\x1a\n")
+    out += struct.pack("<9I", VK_FORMAT_BC7_SRGB_BLOCK, 1, WIDTH, HEIGHT, 0, 0, 1, level_count, 0)
+    out += struct.pack("<4I2Q", dfd_offset, len(descriptor), 0, 0, 0, 0)
+    for i in range(level_count):
+        out += struct.pack("<3Q", offsets[i], len(levels[i]), len(levels[i]))
+    out += descriptor
+    for i in reversed(range(level_count)):
+        out += b"\0" * (offsets[i] - len(out))
+        out += levels[i]
+
+    with open("mipdebug.ktx2", "wb") as f:
+        f.write(out)
+
+
+if __name__ == "__main__":
+    main()